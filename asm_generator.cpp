@@ -4,6 +4,7 @@
 // =============================
 #include "node.h"
 #include "symbol.h"
+#include "asm_generator.h"
 #include <fstream>
 #include <iostream>
 #include <vector>
@@ -12,17 +13,63 @@
 #include <algorithm>
 #include <sstream>
 #include <iomanip>
+#include <map>
+#include <thread>
+#include <atomic>
 using namespace std;
 
 // ===== 数据结构 =====
 struct StringData { string label; string text; };
 struct RealData { string label; double value; };
 
-static vector<StringData> ro_strings;
-static vector<RealData> ro_reals;
-static int str_counter = 0;
-static int real_counter = 0;
-static int input_cleanup_counter = 0;
+// 每个顶层 fang 块独立生成代码：常量池和标签计数器都属于块自己，
+// 标签带块号前缀 (str_<块>_<n>)，不同线程之间互不干扰
+struct BlockCtx {
+    int block = 0;
+    vector<StringData> ro_strings;
+    vector<RealData> ro_reals;
+    int str_counter = 0;
+    int real_counter = 0;
+    int input_cleanup_counter = 0;
+    string text;
+};
+
+static thread_local BlockCtx* cur_block = nullptr;
+static AsmOptions asm_opts;
+
+// ===== 目标 CPU =====
+bool parse_target_arch(const string &name, TargetArch &arch) {
+    if (name == "sse2" || name == "x86-64") arch = TargetArch::SSE2;
+    else if (name == "avx2") arch = TargetArch::AVX2;
+    else if (name == "avx2-fma" || name == "avx2+fma") arch = TargetArch::AVX2_FMA;
+    else if (name == "native") arch = detect_host_arch();
+    else return false;
+    return true;
+}
+
+const char* target_arch_name(TargetArch arch) {
+    switch (arch) {
+        case TargetArch::SSE2: return "sse2";
+        case TargetArch::AVX2: return "avx2";
+        case TargetArch::AVX2_FMA: return "avx2-fma";
+    }
+    return "sse2";
+}
+
+TargetArch detect_host_arch() {
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        if (__builtin_cpu_supports("fma")) return TargetArch::AVX2_FMA;
+        return TargetArch::AVX2;
+    }
+#endif
+    return TargetArch::SSE2;
+}
+
+static bool use_vex() { return asm_opts.arch != TargetArch::SSE2; }
+static bool use_fma() { return asm_opts.arch == TargetArch::AVX2_FMA && !asm_opts.strict_fp; }
+static const char* movsd_op() { return use_vex() ? "vmovsd" : "movsd"; }
 
 // ===== 工具函数 =====
 static string strip_quotes(const string &s) {
@@ -30,20 +77,20 @@ static string strip_quotes(const string &s) {
         return s.substr(1, s.size() - 2);
     return s;
 }
-static string make_str_label() { ostringstream oss; oss << "str_" << str_counter++; return oss.str(); }
-static string make_real_label() { ostringstream oss; oss << "LC_real_" << real_counter++; return oss.str(); }
+static string make_str_label() { ostringstream oss; oss << "str_" << cur_block->block << "_" << cur_block->str_counter++; return oss.str(); }
+static string make_real_label() { ostringstream oss; oss << "LC_real_" << cur_block->block << "_" << cur_block->real_counter++; return oss.str(); }
 
 static string intern_string(const string &raw) {
     string txt = strip_quotes(raw);
-    for (auto &s : ro_strings) if (s.text == txt) return s.label;
+    for (auto &s : cur_block->ro_strings) if (s.text == txt) return s.label;
     string lbl = make_str_label();
-    ro_strings.push_back({lbl, txt});
+    cur_block->ro_strings.push_back({lbl, txt});
     return lbl;
 }
 static string intern_real(double v) {
-    for (auto &r : ro_reals) if (r.value == v) return r.label;
+    for (auto &r : cur_block->ro_reals) if (r.value == v) return r.label;
     string lbl = make_real_label();
-    ro_reals.push_back({lbl, v});
+    cur_block->ro_reals.push_back({lbl, v});
     return lbl;
 }
 
@@ -74,8 +121,34 @@ static set<string> collect_idents() {
     return ids;
 }
 
+// ===== 合并各块常量池 =====
+// 按块顺序去重；重复的常量只保留一份数据，各块的标签都指向它
+struct MergedString { vector<string> labels; string text; };
+struct MergedReal { vector<string> labels; double value; };
+
+static void merge_rodata(const vector<BlockCtx> &blocks,
+                         vector<MergedString> &strings, vector<MergedReal> &reals) {
+    map<string, size_t> str_index;
+    map<double, size_t> real_index;
+    for (auto &b : blocks) {
+        for (auto &s : b.ro_strings) {
+            auto it = str_index.find(s.text);
+            if (it != str_index.end()) { strings[it->second].labels.push_back(s.label); continue; }
+            str_index[s.text] = strings.size();
+            strings.push_back({{s.label}, s.text});
+        }
+        for (auto &r : b.ro_reals) {
+            auto it = real_index.find(r.value);
+            if (it != real_index.end()) { reals[it->second].labels.push_back(r.label); continue; }
+            real_index[r.value] = reals.size();
+            reals.push_back({{r.label}, r.value});
+        }
+    }
+}
+
 // ===== 汇编头尾 =====
-static void emit_prologue(ostream &os, const set<string> &vars) {
+static void emit_prologue(ostream &os, const set<string> &vars,
+                          const vector<MergedString> &ro_strings, const vector<MergedReal> &ro_reals) {
     os << "\t.section .rodata\n";
     os << "fmt_int_print:\n\t.asciz \"%ld\\n\"\n";
     os << "fmt_int_scanf:\n\t.asciz \"%ld\"\n";
@@ -87,11 +160,13 @@ static void emit_prologue(ostream &os, const set<string> &vars) {
         string safe = s.text;
         size_t pos;
         while ((pos = safe.find('\n')) != string::npos) safe.replace(pos, 1, "\\n");
-        os << s.label << ":\n\t.asciz \"" << safe << "\"\n";
+        for (auto &l : s.labels) os << l << ":\n";
+        os << "\t.asciz \"" << safe << "\"\n";
     }
     for (auto &r : ro_reals) {
         ostringstream oss; oss << setprecision(12) << r.value;
-        os << r.label << ":\n\t.double " << oss.str() << "\n";
+        for (auto &l : r.labels) os << l << ":\n";
+        os << "\t.double " << oss.str() << "\n";
     }
 
     os << "\n\t.section .data\n";
@@ -120,7 +195,7 @@ static void emit_input_int(const string &prompt_label, ostream &os) {
     os << "\tleaq input_val_int(%rip), %rsi\n";
     os << "\tleaq fmt_int_scanf(%rip), %rdi\n";
     os << "\txor %rax,%rax\n\tcall scanf@PLT\n";
-    int id = input_cleanup_counter++;
+    string id = to_string(cur_block->block) + "_" + to_string(cur_block->input_cleanup_counter++);
     os << ".__cleanup_input_int_" << id << ":\n\tcall getchar@PLT\n";
     os << "\tcmp $-1,%eax\n\tje .__cleanup_input_int_" << id << "_end\n";
     os << "\tcmp $10,%eax\n\tje .__cleanup_input_int_" << id << "_end\n";
@@ -135,13 +210,13 @@ static void emit_input_real(const string &prompt_label, ostream &os) {
     os << "\tleaq input_val_real(%rip), %rsi\n";
     os << "\tleaq fmt_double_scanf(%rip), %rdi\n";
     os << "\txor %rax,%rax\n\tcall scanf@PLT\n";
-    int id = input_cleanup_counter++;
+    string id = to_string(cur_block->block) + "_" + to_string(cur_block->input_cleanup_counter++);
     os << ".__cleanup_input_real_" << id << ":\n\tcall getchar@PLT\n";
     os << "\tcmp $-1,%eax\n\tje .__cleanup_input_real_" << id << "_end\n";
     os << "\tcmp $10,%eax\n\tje .__cleanup_input_real_" << id << "_end\n";
     os << "\tjmp .__cleanup_input_real_" << id << "\n";
     os << ".__cleanup_input_real_" << id << "_end:\n";
-    os << "\tmovsd input_val_real(%rip), %xmm0\n";
+    os << "\t" << movsd_op() << " input_val_real(%rip), %xmm0\n";
 }
 
 // ===== 类型判断 =====
@@ -159,15 +234,99 @@ static bool expr_is_real(Node* node) {
 }
 
 // ===== 表达式生成 =====
-static void emit_expr(Node* node, ostream &os, bool expect_real = false) {
+static void emit_expr(Node* node, ostream &os, bool expect_real = false);
+
+// ===== AVX (VEX 三操作数) 浮点运算 =====
+// 结果统一放在 %xmm0；需要保存的中间值按 16 字节压栈，保持调用 printf/scanf 时的栈对齐
+
+// 浮点字面量或 real 变量可直接作为内存操作数，返回空串表示需要先求值
+static string real_mem_operand(Node* node) {
+    if (auto r = dynamic_cast<Real*>(node)) return intern_real(r->val) + "(%rip)";
+    if (auto v = dynamic_cast<Var*>(node)) {
+        string vt = get_symbol_type(v->name);
+        if (vt == "real" || vt == "double" || vt == "float") return v->name + "(%rip)";
+    }
+    return "";
+}
+
+// 把 node 的值求到 %xmm<reg>，同时保留 %xmm0..%xmm<live-1> 中已有的值
+static void emit_real_into(Node* node, int reg, int live, ostream &os) {
+    string mem = real_mem_operand(node);
+    if (!mem.empty()) { os << "\tvmovsd " << mem << ", %xmm" << reg << "\n"; return; }
+    if (live > 0) {
+        os << "\tsubq $" << 16 * live << ", %rsp\n";
+        for (int i = 0; i < live; ++i) os << "\tvmovsd %xmm" << i << ", " << 16 * i << "(%rsp)\n";
+    }
+    emit_expr(node, os, true);
+    if (reg != 0) os << "\tvmovapd %xmm0, %xmm" << reg << "\n";
+    if (live > 0) {
+        for (int i = 0; i < live; ++i) if (i != reg) os << "\tvmovsd " << 16 * i << "(%rsp), %xmm" << i << "\n";
+        os << "\taddq $" << 16 * live << ", %rsp\n";
+    }
+}
+
+static bool is_mul(Node* node) {
+    auto b = dynamic_cast<Binary*>(node);
+    return b && b->op == "*";
+}
+
+// a*b+c / a*b-c / c+a*b / c-a*b 合并为一条 FMA，操作数仍按源码顺序求值
+static bool emit_fma_vex(Binary* b, ostream &os) {
+    if (b->op != "+" && b->op != "-") return false;
+    Binary* mul = nullptr;
+    Node* addend = nullptr;
+    bool mul_first = false;
+    if (is_mul(b->left.get())) { mul = static_cast<Binary*>(b->left.get()); addend = b->right.get(); mul_first = true; }
+    else if (is_mul(b->right.get())) { mul = static_cast<Binary*>(b->right.get()); addend = b->left.get(); }
+    else return false;
+
+    Node* last = mul_first ? addend : mul->right.get();
+    if (mul_first) {
+        emit_expr(mul->left.get(), os, true);
+        emit_real_into(mul->right.get(), 1, 1, os);
+    } else {
+        emit_expr(addend, os, true);
+        emit_real_into(mul->left.get(), 1, 1, os);
+    }
+    string src3 = real_mem_operand(last);
+    if (src3.empty()) { emit_real_into(last, 2, 2, os); src3 = "%xmm2"; }
+
+    // 213: xmm0 = xmm1*xmm0 ± src3      231: xmm0 = ±(xmm1*src3) + xmm0
+    if (mul_first) os << (b->op == "+" ? "\tvfmadd213sd " : "\tvfmsub213sd ");
+    else os << (b->op == "+" ? "\tvfmadd231sd " : "\tvfnmadd231sd ");
+    os << src3 << ", %xmm1, %xmm0\n";
+    return true;
+}
+
+static void emit_real_binary_vex(Binary* b, ostream &os) {
+    if (use_fma() && emit_fma_vex(b, os)) return;
+
+    const char* op = "vaddsd";
+    if (b->op == "-") op = "vsubsd";
+    else if (b->op == "*") op = "vmulsd";
+    else if (b->op == "/") op = "vdivsd";
+
+    emit_expr(b->left.get(), os, true);
+    string rhs = real_mem_operand(b->right.get());
+    if (!rhs.empty()) {
+        os << "\t" << op << " " << rhs << ", %xmm0, %xmm0\n";
+        return;
+    }
+    os << "\tsubq $16, %rsp\n\tvmovsd %xmm0, (%rsp)\n";
+    emit_expr(b->right.get(), os, true);
+    os << "\tvmovsd (%rsp), %xmm1\n\taddq $16, %rsp\n";
+    os << "\t" << op << " %xmm0, %xmm1, %xmm0\n";
+}
+
+static void emit_expr(Node* node, ostream &os, bool expect_real) {
     if (!node) { os << "\tmovq $0, %rax\n"; return; }
 
     if (auto i = dynamic_cast<Integer*>(node)) { os << "\tmovq $" << i->val << ", %rax\n"; return; }
-    if (auto r = dynamic_cast<Real*>(node)) { string lbl = intern_real(r->val); os << "\tmovsd " << lbl << "(%rip), %xmm0\n"; return; }
+    if (auto r = dynamic_cast<Real*>(node)) { string lbl = intern_real(r->val); os << "\t" << movsd_op() << " " << lbl << "(%rip), %xmm0\n"; return; }
     if (auto v = dynamic_cast<Var*>(node)) {
         string vt = get_symbol_type(v->name);
         if (vt == "real" || vt == "double" || vt == "float")
-            os << "\tmovsd " << v->name << "(%rip), %xmm0\n";
+            os << "\t" << movsd_op() << " " << v->name << "(%rip), %xmm0\n";
         else
             os << "\tmovq " << v->name << "(%rip), %rax\n";
         return;
@@ -180,11 +339,14 @@ static void emit_expr(Node* node, ostream &os, bool expect_real = false) {
     }
     if (auto b = dynamic_cast<Binary*>(node)) {
         bool is_real = expr_is_real(b) || expect_real;
-        if (is_real) {
+        if (is_real && use_vex()) {
+            emit_real_binary_vex(b, os);
+        } else if (is_real) {
+            // 左值压入 16 字节栈槽：右侧嵌套表达式会改写任何 xmm 寄存器
             emit_expr(b->left.get(), os, true);
-            os << "\tmovsd %xmm0, %xmm2\n";
+            os << "\tsubq $16, %rsp\n\tmovsd %xmm0, (%rsp)\n";
             emit_expr(b->right.get(), os, true);
-            os << "\tmovsd %xmm2, %xmm1\n";
+            os << "\tmovsd (%rsp), %xmm1\n\taddq $16, %rsp\n";
             if (b->op == "+") os << "\taddsd %xmm0, %xmm1\n";
             else if (b->op == "-") os << "\tsubsd %xmm0, %xmm1\n";
             else if (b->op == "*") os << "\tmulsd %xmm0, %xmm1\n";
@@ -237,13 +399,13 @@ static void emit_stmt(Node* stmt, ostream &ofs) {
             string lbl = intern_string(in->prompt);
             string vt = get_symbol_type(as->name);
             bool tgt_real = (vt == "real" || vt == "double" || vt == "float");
-            if (tgt_real) { emit_input_real(lbl, ofs); ofs << "\tmovsd %xmm0, " << as->name << "(%rip)\n"; }
+            if (tgt_real) { emit_input_real(lbl, ofs); ofs << "\t" << movsd_op() << " %xmm0, " << as->name << "(%rip)\n"; }
             else { emit_input_int(lbl, ofs); ofs << "\tmovq %rax, " << as->name << "(%rip)\n"; }
         } else {
             string vt = get_symbol_type(as->name);
             bool expect_real = (vt == "real" || vt == "double" || vt == "float");
             emit_expr(as->expr.get(), ofs, expect_real);
-            if (expect_real) ofs << "\tmovsd %xmm0, " << as->name << "(%rip)\n";
+            if (expect_real) ofs << "\t" << movsd_op() << " %xmm0, " << as->name << "(%rip)\n";
             else ofs << "\tmovq %rax, " << as->name << "(%rip)\n";
         }
         return;
@@ -262,20 +424,47 @@ static void emit_stmt(Node* stmt, ostream &ofs) {
     }
 }
 
+// ===== 单块生成 =====
+static void generate_block(Node* stmt, BlockCtx &ctx) {
+    cur_block = &ctx;
+    collect_rodata_stmt(stmt);
+    ostringstream oss;
+    emit_stmt(stmt, oss);
+    ctx.text = oss.str();
+    cur_block = nullptr;
+}
+
 // ===== 顶层接口 =====
-bool generate_asm(Program* root, const string &out_filename) {
+bool generate_asm(Program* root, const string &out_filename, const AsmOptions &opts) {
     if (!root) return false;
+    asm_opts = opts;
     ofstream ofs(out_filename);
     if (!ofs) return false;
 
-    ro_strings.clear(); ro_reals.clear(); str_counter = real_counter = input_cleanup_counter = 0;
-    for (auto &stmt : root->stmts) collect_rodata_stmt(stmt.get());
+    // 各块只读共享符号表和 asm_opts，可并行生成；输出只取决于块号，与线程数无关
+    vector<BlockCtx> blocks(root->stmts.size());
+    for (size_t i = 0; i < blocks.size(); ++i) blocks[i].block = (int)i;
+
+    size_t jobs = opts.jobs ? opts.jobs : max(1u, thread::hardware_concurrency());
+    jobs = min(jobs, blocks.size());
+    atomic<size_t> next(0);
+    auto worker = [&]() {
+        for (size_t i; (i = next++) < blocks.size(); )
+            generate_block(root->stmts[i].get(), blocks[i]);
+    };
+    vector<thread> pool;
+    for (size_t t = 1; t < jobs; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool) t.join();
+
+    vector<MergedString> strings;
+    vector<MergedReal> reals;
+    merge_rodata(blocks, strings, reals);
     auto idents = collect_idents();
 
-    emit_prologue(ofs, idents);
-    for (auto &stmt : root->stmts) emit_stmt(stmt.get(), ofs);
+    emit_prologue(ofs, idents, strings, reals);
+    for (auto &b : blocks) ofs << b.text;
     emit_epilogue(ofs);
     ofs.close();
     return true;
 }
-
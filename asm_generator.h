@@ -0,0 +1,28 @@
+#ifndef ASM_GENERATOR_H
+#define ASM_GENERATOR_H
+
+#include <string>
+#include "node.h"
+
+// ======= 目标 CPU 特性 =======
+// 按能力递增排列，后者包含前者
+enum class TargetArch { SSE2, AVX2, AVX2_FMA };
+
+struct AsmOptions {
+    TargetArch arch = TargetArch::SSE2;
+    bool strict_fp = false;   // 禁止 a*b+c 合并为 FMA，结果与 SSE2 逐位一致
+    unsigned jobs = 0;        // 并行生成各 fang 块的线程数，0 表示按 CPU 核数
+};
+
+// 解析 -march 取值：sse2 / avx2 / avx2-fma / native
+bool parse_target_arch(const std::string &name, TargetArch &arch);
+const char* target_arch_name(TargetArch arch);
+
+// 运行时检测当前 CPU 支持的最高目标
+TargetArch detect_host_arch();
+inline bool host_supports(TargetArch arch) { return arch <= detect_host_arch(); }
+
+bool generate_asm(Program* root, const std::string &out_filename,
+                  const AsmOptions &opts = AsmOptions());
+
+#endif // ASM_GENERATOR_H
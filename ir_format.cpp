@@ -0,0 +1,328 @@
+// =============================
+// ir_format.cpp
+// Fang 二进制 IR 的写出、mmap 加载与 AST 恢复
+// =============================
+#include "ir_format.h"
+#include <fstream>
+#include <unordered_map>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+using namespace std;
+
+// ===== 写出 =====
+namespace {
+
+struct IRBuilder {
+    vector<IRNode> nodes;
+    vector<uint32_t> children;
+    vector<IRSymbol> symbols;
+    vector<IRTAC> tac;
+    string strings;
+    unordered_map<string, uint32_t> string_ids;
+
+    IRBuilder() { strings.push_back('\0'); string_ids[""] = 0; }
+
+    uint32_t intern(const string &s) {
+        auto it = string_ids.find(s);
+        if (it != string_ids.end()) return it->second;
+        uint32_t off = (uint32_t)strings.size();
+        strings.append(s);
+        strings.push_back('\0');
+        string_ids[s] = off;
+        return off;
+    }
+
+    static uint8_t value_type_of(const string &vt) {
+        if (vt == "real" || vt == "double" || vt == "float") return IR_TYPE_REAL;
+        if (vt == "int") return IR_TYPE_INT;
+        return IR_TYPE_NONE;
+    }
+
+    // 先序分配结点下标；同一结点的子结点在 children 中连续存放
+    uint32_t add(Node* node) {
+        uint32_t idx = (uint32_t)nodes.size();
+        nodes.push_back(IRNode());
+        IRNode n;
+        memset(&n, 0, sizeof(n));
+        vector<Node*> kids;
+
+        if (auto prog = dynamic_cast<Program*>(node)) {
+            n.kind = IR_PROGRAM;
+            for (auto &s : prog->stmts) kids.push_back(s.get());
+        } else if (auto i = dynamic_cast<Integer*>(node)) {
+            n.kind = IR_INTEGER; n.type = IR_TYPE_INT; n.ival = i->val;
+        } else if (auto r = dynamic_cast<Real*>(node)) {
+            n.kind = IR_REAL; n.type = IR_TYPE_REAL; n.fval = r->val;
+        } else if (auto v = dynamic_cast<Var*>(node)) {
+            n.kind = IR_VAR; n.str = intern(v->name);
+            n.type = value_type_of(get_symbol_type(v->name));
+        } else if (auto b = dynamic_cast<Binary*>(node)) {
+            n.kind = IR_BINARY; n.str = intern(b->op);
+            kids = { b->left.get(), b->right.get() };
+        } else if (auto s = dynamic_cast<StringNode*>(node)) {
+            n.kind = IR_STRING; n.str = intern(s->value);
+        } else if (auto in = dynamic_cast<InputNode*>(node)) {
+            n.kind = IR_INPUT; n.type = IR_TYPE_REAL; n.str = intern(in->prompt);
+        } else if (auto es = dynamic_cast<ExprStmt*>(node)) {
+            n.kind = IR_EXPR_STMT;
+            kids.push_back(es->expr.get());
+        } else if (auto as = dynamic_cast<AssignStmt*>(node)) {
+            // lhs 总是 Var(name)，由 name 恢复，不单独存储
+            n.kind = IR_ASSIGN; n.str = intern(as->name);
+            n.type = value_type_of(get_symbol_type(as->name));
+            kids.push_back(as->expr.get());
+        } else if (auto pl = dynamic_cast<PrintStmtList*>(node)) {
+            n.kind = IR_PRINT_LIST;
+            for (auto &e : pl->exprs) kids.push_back(e.get());
+        } else if (auto ps = dynamic_cast<PrintStmt*>(node)) {
+            n.kind = IR_PRINT;
+            kids.push_back(ps->expr.get());
+        }
+
+        vector<uint32_t> ids;
+        for (Node* k : kids) if (k) ids.push_back(add(k));
+
+        // Binary 的类型依赖子结点，与 asm_generator 的 expr_is_real 规则一致
+        if (n.kind == IR_BINARY) {
+            n.type = IR_TYPE_INT;
+            for (uint32_t id : ids) if (nodes[id].type == IR_TYPE_REAL) n.type = IR_TYPE_REAL;
+        }
+        // 直接赋给变量的 input 按目标类型读取 (与 emit_stmt 一致)，其余位置一律按 real 读取
+        if (n.kind == IR_ASSIGN && ids.size() == 1 && nodes[ids[0]].kind == IR_INPUT)
+            nodes[ids[0]].type = n.type == IR_TYPE_REAL ? IR_TYPE_REAL : IR_TYPE_INT;
+
+        n.first_child = (uint32_t)children.size();
+        n.child_count = (uint32_t)ids.size();
+        children.insert(children.end(), ids.begin(), ids.end());
+        nodes[idx] = n;
+        return idx;
+    }
+
+    uint32_t arg(const TACArg &a) {
+        if (a.kind == TAC_TEMP) return a.temp;
+        if (a.kind == TAC_NONE) return 0;
+        return intern(a.text);
+    }
+
+    void add_tac(const TACInstr &t) {
+        IRTAC r;
+        memset(&r, 0, sizeof(r));
+        r.op = t.op;
+        r.dst_kind = t.dst.kind; r.arg1_kind = t.arg1.kind; r.arg2_kind = t.arg2.kind;
+        r.oper = intern(t.oper);
+        r.dst = arg(t.dst); r.arg1 = arg(t.arg1); r.arg2 = arg(t.arg2);
+        tac.push_back(r);
+    }
+};
+
+uint64_t align8(uint64_t v) { return (v + 7) & ~(uint64_t)7; }
+
+void write_section(ofstream &ofs, uint64_t off, const void *data, size_t bytes) {
+    ofs.seekp((streamoff)off);
+    if (bytes) ofs.write(static_cast<const char*>(data), (streamsize)bytes);
+}
+
+} // namespace
+
+bool ir_write(const string &path, Program* root,
+              const vector<Symbol> &symbols,
+              const vector<TACInstr> &tac) {
+    if (!root) return false;
+
+    IRBuilder b;
+    uint32_t root_idx = b.add(root);
+    for (auto &s : symbols) {
+        IRSymbol sym;
+        sym.name = b.intern(s.name);
+        sym.type = b.intern(s.type);
+        sym.value_type = b.intern(s.value_type);
+        sym.reserved = 0;
+        b.symbols.push_back(sym);
+    }
+    for (auto &t : tac) b.add_tac(t);
+
+    IRHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, IR_MAGIC, sizeof(h.magic));
+    h.version = IR_VERSION;
+    h.root = root_idx;
+    h.node_count = (uint32_t)b.nodes.size();
+    h.child_count = (uint32_t)b.children.size();
+    h.symbol_count = (uint32_t)b.symbols.size();
+    h.tac_count = (uint32_t)b.tac.size();
+    h.string_bytes = (uint32_t)b.strings.size();
+    h.node_off = align8(sizeof(IRHeader));
+    h.child_off = align8(h.node_off + (uint64_t)h.node_count * sizeof(IRNode));
+    h.symbol_off = align8(h.child_off + (uint64_t)h.child_count * sizeof(uint32_t));
+    h.tac_off = align8(h.symbol_off + (uint64_t)h.symbol_count * sizeof(IRSymbol));
+    h.string_off = align8(h.tac_off + (uint64_t)h.tac_count * sizeof(IRTAC));
+
+    ofstream ofs(path, ios::binary | ios::trunc);
+    if (!ofs) return false;
+    // 先写满整个文件再回填各段，保证对齐空隙为 0
+    string zeros(h.string_off + h.string_bytes, '\0');
+    ofs.write(zeros.data(), (streamsize)zeros.size());
+    write_section(ofs, 0, &h, sizeof(h));
+    write_section(ofs, h.node_off, b.nodes.data(), b.nodes.size() * sizeof(IRNode));
+    write_section(ofs, h.child_off, b.children.data(), b.children.size() * sizeof(uint32_t));
+    write_section(ofs, h.symbol_off, b.symbols.data(), b.symbols.size() * sizeof(IRSymbol));
+    write_section(ofs, h.tac_off, b.tac.data(), b.tac.size() * sizeof(IRTAC));
+    write_section(ofs, h.string_off, b.strings.data(), b.strings.size());
+    return (bool)ofs;
+}
+
+// ===== mmap 加载 =====
+IRFile::~IRFile() { close(); }
+
+void IRFile::close() {
+    if (base_) munmap(const_cast<char*>(base_), size_);
+    base_ = nullptr;
+    size_ = 0;
+}
+
+bool IRFile::open(const string &path, string &err) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) { err = "cannot open " + path; return false; }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(IRHeader)) {
+        ::close(fd);
+        err = path + ": file too small for IR header";
+        return false;
+    }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (p == MAP_FAILED) { err = "mmap failed for " + path; return false; }
+    base_ = static_cast<const char*>(p);
+    size_ = (size_t)st.st_size;
+
+    auto fail = [&](const string &why) { close(); err = path + ": " + why; return false; };
+    const IRHeader &h = header();
+    if (memcmp(h.magic, IR_MAGIC, sizeof(h.magic)) != 0) return fail("bad magic");
+    if (h.version != IR_VERSION)
+        return fail("unsupported IR version " + to_string(h.version));
+
+    auto in_bounds = [&](uint64_t off, uint64_t count, uint64_t elem) {
+        return off % 8 == 0 && off <= size_ && count <= (size_ - off) / elem;
+    };
+    if (!in_bounds(h.node_off, h.node_count, sizeof(IRNode)) ||
+        !in_bounds(h.child_off, h.child_count, sizeof(uint32_t)) ||
+        !in_bounds(h.symbol_off, h.symbol_count, sizeof(IRSymbol)) ||
+        !in_bounds(h.tac_off, h.tac_count, sizeof(IRTAC)) ||
+        !in_bounds(h.string_off, h.string_bytes, 1))
+        return fail("section out of bounds");
+
+    nodes_ = reinterpret_cast<const IRNode*>(base_ + h.node_off);
+    children_ = reinterpret_cast<const uint32_t*>(base_ + h.child_off);
+    symbols_ = reinterpret_cast<const IRSymbol*>(base_ + h.symbol_off);
+    tac_ = reinterpret_cast<const IRTAC*>(base_ + h.tac_off);
+    strings_ = base_ + h.string_off;
+
+    // 一次性校验所有下标，之后的访问器不再检查
+    if (h.string_bytes == 0 || strings_[h.string_bytes - 1] != '\0') return fail("bad string table");
+    if (h.root >= h.node_count || nodes_[h.root].kind != IR_PROGRAM) return fail("bad root node");
+    for (uint32_t i = 0; i < h.node_count; ++i) {
+        const IRNode &n = nodes_[i];
+        if (n.kind >= IR_KIND_COUNT || n.str >= h.string_bytes) return fail("bad node " + to_string(i));
+        if (n.first_child > h.child_count || n.child_count > h.child_count - n.first_child)
+            return fail("bad child range in node " + to_string(i));
+    }
+    // 子结点下标必须大于父结点 (先序)，保证无环
+    for (uint32_t i = 0; i < h.node_count; ++i) {
+        const IRNode &n = nodes_[i];
+        for (uint32_t k = 0; k < n.child_count; ++k) {
+            uint32_t c = children_[n.first_child + k];
+            if (c >= h.node_count || c <= i) return fail("bad child index in node " + to_string(i));
+        }
+    }
+    for (uint32_t i = 0; i < h.symbol_count; ++i) {
+        const IRSymbol &s = symbols_[i];
+        if (s.name >= h.string_bytes || s.type >= h.string_bytes || s.value_type >= h.string_bytes)
+            return fail("bad symbol " + to_string(i));
+    }
+    auto bad_arg = [&](uint8_t kind, uint32_t v) {
+        return kind >= TAC_ARG_KIND_COUNT || (kind != TAC_TEMP && v >= h.string_bytes);
+    };
+    for (uint32_t i = 0; i < h.tac_count; ++i) {
+        const IRTAC &t = tac_[i];
+        if (t.op >= TAC_OP_COUNT || t.oper >= h.string_bytes || bad_arg(t.dst_kind, t.dst) ||
+            bad_arg(t.arg1_kind, t.arg1) || bad_arg(t.arg2_kind, t.arg2))
+            return fail("bad TAC instruction " + to_string(i));
+    }
+    return true;
+}
+
+bool ir_is_file(const string &path) {
+    ifstream ifs(path, ios::binary);
+    char magic[sizeof(IR_MAGIC)];
+    if (!ifs.read(magic, sizeof(magic))) return false;
+    return memcmp(magic, IR_MAGIC, sizeof(magic)) == 0;
+}
+
+// ===== 恢复 AST =====
+static NodePtr ir_build(const IRFile &ir, uint32_t idx) {
+    const IRNode &n = ir.node(idx);
+    auto kid = [&](uint32_t k) { return k < n.child_count ? ir_build(ir, ir.child(n, k)) : nullptr; };
+
+    switch (n.kind) {
+        case IR_PROGRAM: {
+            auto p = make_shared<Program>();
+            for (uint32_t k = 0; k < n.child_count; ++k) p->stmts.push_back(kid(k));
+            return p;
+        }
+        case IR_INTEGER: return make_shared<Integer>((long)n.ival);
+        case IR_REAL:    return make_shared<Real>(n.fval);
+        case IR_VAR:     return make_shared<Var>(ir.str(n.str));
+        case IR_BINARY:  return make_shared<Binary>(ir.str(n.str), kid(0), kid(1));
+        case IR_STRING:  return make_shared<StringNode>(ir.str(n.str));
+        case IR_INPUT:   return make_shared<InputNode>(ir.str(n.str));
+        case IR_EXPR_STMT: return make_shared<ExprStmt>(kid(0));
+        case IR_ASSIGN:  return make_shared<AssignStmt>(ir.str(n.str), kid(0));
+        case IR_PRINT:   return make_shared<PrintStmt>(kid(0));
+        case IR_PRINT_LIST: {
+            vector<NodePtr> exprs;
+            for (uint32_t k = 0; k < n.child_count; ++k) exprs.push_back(kid(k));
+            return make_shared<PrintStmtList>(exprs);
+        }
+    }
+    return nullptr;
+}
+
+Program* ir_load_program(const IRFile &ir) {
+    // Var 构造时要查符号表，先恢复符号表
+    sym_table.clear();
+    for (uint32_t i = 0; i < ir.symbol_count(); ++i) {
+        const IRSymbol &s = ir.symbol(i);
+        sym_table.push_back({ ir.str(s.name), ir.str(s.type), ir.str(s.value_type) });
+    }
+
+    const IRNode &root = ir.node(ir.root());
+    Program* prog = new Program();
+    for (uint32_t k = 0; k < root.child_count; ++k)
+        prog->stmts.push_back(ir_build(ir, ir.child(root, k)));
+    return prog;
+}
+
+vector<TACInstr> ir_load_tac(const IRFile &ir) {
+    auto arg = [&](uint8_t kind, uint32_t v) {
+        if (kind == TAC_TEMP) return tac_temp(v);
+        if (kind == TAC_NONE) return TACArg();
+        return tac_arg((TACArgKind)kind, ir.str(v));
+    };
+    vector<TACInstr> tac;
+    tac.reserve(ir.tac_count());
+    for (uint32_t i = 0; i < ir.tac_count(); ++i) {
+        const IRTAC &r = ir.tac(i);
+        TACInstr t;
+        t.op = (TACOp)r.op;
+        t.oper = ir.str(r.oper);
+        t.dst = arg(r.dst_kind, r.dst);
+        t.arg1 = arg(r.arg1_kind, r.arg1);
+        t.arg2 = arg(r.arg2_kind, r.arg2);
+        tac.push_back(t);
+    }
+    return tac;
+}
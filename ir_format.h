@@ -0,0 +1,141 @@
+#ifndef IR_FORMAT_H
+#define IR_FORMAT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "node.h"
+#include "symbol.h"
+#include "tac.h"
+
+// ======= Fang 二进制 IR (.fir) =======
+// 带类型的 AST、符号表和 TAC 的扁平化表示，可直接 mmap 使用，无需反序列化。
+// 文件布局 (本机字节序，各段 8 字节对齐)：
+//   IRHeader
+//   IRNode   nodes[node_count]      子结点用 children 数组中的下标区间表示
+//   uint32_t children[child_count]  结点下标
+//   IRSymbol symbols[symbol_count]
+//   IRTAC    tac[tac_count]         TAC 指令记录，操作数为临时变量编号或字符串表偏移
+//   char     strings[string_bytes]  以 '\0' 结尾的字符串，去重；偏移 0 为空串
+
+static const char IR_MAGIC[4] = { 'F', 'I', 'R', '\0' };
+static const uint32_t IR_VERSION = 2;
+
+enum IRKind : uint8_t {
+    IR_PROGRAM = 0,
+    IR_INTEGER,
+    IR_REAL,
+    IR_VAR,
+    IR_BINARY,
+    IR_STRING,
+    IR_INPUT,
+    IR_EXPR_STMT,
+    IR_ASSIGN,
+    IR_PRINT,
+    IR_PRINT_LIST,
+    IR_KIND_COUNT
+};
+
+enum IRType : uint8_t { IR_TYPE_NONE = 0, IR_TYPE_INT, IR_TYPE_REAL };
+
+struct IRHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t root;           // 根结点 (Program) 下标
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t symbol_count;
+    uint32_t tac_count;
+    uint32_t string_bytes;
+    uint64_t node_off;
+    uint64_t child_off;
+    uint64_t symbol_off;
+    uint64_t tac_off;
+    uint64_t string_off;
+};
+
+struct IRNode {
+    uint8_t kind;            // IRKind
+    uint8_t type;            // IRType，表达式的求值类型 / 赋值目标类型
+    uint16_t reserved;
+    uint32_t str;            // 变量名 / 运算符 / 字符串字面量 / 输入提示
+    uint32_t first_child;
+    uint32_t child_count;
+    union { int64_t ival; double fval; };
+};
+
+struct IRSymbol {
+    uint32_t name;
+    uint32_t type;           // "ident" / "literal"
+    uint32_t value_type;     // "int" / "real"
+    uint32_t reserved;
+};
+
+// 操作数按 kind 解释：TAC_TEMP 为临时变量编号，TAC_NONE 为 0，
+// 其余 (变量名 / 常量文本 / 字符串字面量 / 输入提示) 为字符串表偏移
+struct IRTAC {
+    uint8_t op;              // TACOp
+    uint8_t dst_kind;        // TACArgKind
+    uint8_t arg1_kind;
+    uint8_t arg2_kind;
+    uint32_t oper;           // TAC_BINARY 的运算符
+    uint32_t dst;
+    uint32_t arg1;
+    uint32_t arg2;
+};
+
+static_assert(sizeof(IRHeader) == 72, "IRHeader layout");
+static_assert(sizeof(IRNode) == 24, "IRNode layout");
+static_assert(sizeof(IRSymbol) == 16, "IRSymbol layout");
+static_assert(sizeof(IRTAC) == 20, "IRTAC layout");
+
+// ======= 只读 mmap 视图 =======
+// open() 只做边界校验，之后所有访问都直接落在映射内存上
+class IRFile {
+public:
+    IRFile() = default;
+    ~IRFile();
+    IRFile(const IRFile&) = delete;
+    IRFile& operator=(const IRFile&) = delete;
+
+    bool open(const std::string &path, std::string &err);
+    void close();
+
+    const IRHeader& header() const { return *reinterpret_cast<const IRHeader*>(base_); }
+    uint32_t root() const { return header().root; }
+    uint32_t node_count() const { return header().node_count; }
+    uint32_t symbol_count() const { return header().symbol_count; }
+    uint32_t tac_count() const { return header().tac_count; }
+
+    const IRNode& node(uint32_t i) const { return nodes_[i]; }
+    uint32_t child(const IRNode &n, uint32_t k) const { return children_[n.first_child + k]; }
+    const IRSymbol& symbol(uint32_t i) const { return symbols_[i]; }
+    const IRTAC& tac(uint32_t i) const { return tac_[i]; }
+    const char* str(uint32_t off) const { return strings_ + off; }
+
+private:
+    const char* base_ = nullptr;
+    size_t size_ = 0;
+    const IRNode* nodes_ = nullptr;
+    const uint32_t* children_ = nullptr;
+    const IRSymbol* symbols_ = nullptr;
+    const IRTAC* tac_ = nullptr;
+    const char* strings_ = nullptr;
+};
+
+// 判断文件是否以 IR 魔数开头
+bool ir_is_file(const std::string &path);
+
+// 将 AST、符号表和 TAC 写成 .fir 文件
+bool ir_write(const std::string &path, Program* root,
+              const std::vector<Symbol> &symbols,
+              const std::vector<TACInstr> &tac);
+
+// 由 IR 视图恢复全局符号表和 AST，供 asm_generator 使用
+Program* ir_load_program(const IRFile &ir);
+
+// 由 IR 视图恢复 TAC 指令
+std::vector<TACInstr> ir_load_tac(const IRFile &ir);
+
+#endif // IR_FORMAT_H
@@ -8,6 +8,8 @@
 #include "node.h"
 #include "symbol.h"
 #include "asm_generator.h"
+#include "ir_format.h"
+#include "tac.h"
 
 // -------------------- 全局变量 --------------------
 std::vector<Symbol> sym_table;
@@ -18,84 +20,151 @@ extern FILE* yyin;
 extern void yyrestart(FILE*);
 
 // -------------------- TAC 生成 --------------------
-int temp_counter = 0;
-std::vector<std::string> tac_list;
-std::string newTemp() { return "t" + std::to_string(temp_counter++); }
+uint32_t temp_counter = 0;
+std::vector<TACInstr> tac_list;
+TACArg newTemp() { return tac_temp(temp_counter++); }
+
+static void emitTAC(TACOp op, const TACArg &dst, const TACArg &arg1,
+                    const std::string &oper = "", const TACArg &arg2 = TACArg()) {
+    TACInstr t;
+    t.op = op; t.oper = oper; t.dst = dst; t.arg1 = arg1; t.arg2 = arg2;
+    tac_list.push_back(t);
+}
 
-std::string generateTAC(Node* node) {
-    if (!node) return "";
+TACArg generateTAC(Node* node) {
+    if (!node) return TACArg();
 
     if (auto assign = dynamic_cast<AssignStmt*>(node)) {
-        std::string rhs = generateTAC(assign->expr.get());
-        tac_list.push_back(assign->name + " = " + rhs);
-        return assign->name;
+        TACArg rhs = generateTAC(assign->expr.get());
+        TACArg dst = tac_arg(TAC_VAR, assign->name);
+        emitTAC(TAC_COPY, dst, rhs);
+        return dst;
     } else if (auto binary = dynamic_cast<Binary*>(node)) {
-        std::string left = generateTAC(binary->left.get());
-        std::string right = generateTAC(binary->right.get());
-        std::string tmp = newTemp();
-        tac_list.push_back(tmp + " = " + left + " " + binary->op + " " + right);
+        TACArg left = generateTAC(binary->left.get());
+        TACArg right = generateTAC(binary->right.get());
+        TACArg tmp = newTemp();
+        emitTAC(TAC_BINARY, tmp, left, binary->op, right);
         return tmp;
-    } else if (auto integer = dynamic_cast<Integer*>(node)) return std::to_string(integer->val);
-    else if (auto real = dynamic_cast<Real*>(node)) return std::to_string(real->val);
-    else if (auto var = dynamic_cast<Var*>(node)) return var->name;
+    } else if (auto integer = dynamic_cast<Integer*>(node)) return tac_arg(TAC_INT, std::to_string(integer->val));
+    else if (auto real = dynamic_cast<Real*>(node)) return tac_arg(TAC_REAL, std::to_string(real->val));
+    else if (auto var = dynamic_cast<Var*>(node)) return tac_arg(TAC_VAR, var->name);
     else if (auto strNode = dynamic_cast<StringNode*>(node)) {
-        std::string tmp = newTemp();
-        tac_list.push_back(tmp + " = \"" + strNode->value + "\"");
+        TACArg tmp = newTemp();
+        emitTAC(TAC_STRING, tmp, tac_arg(TAC_STR, strNode->value));
         return tmp;
     } else if (auto input = dynamic_cast<InputNode*>(node)) {
-        std::string tmp = newTemp();
-        tac_list.push_back(tmp + " = input(" + input->prompt + ")");
+        TACArg tmp = newTemp();
+        emitTAC(TAC_INPUT, tmp, tac_arg(TAC_STR, input->prompt));
         return tmp;
     } else if (auto printList = dynamic_cast<PrintStmtList*>(node)) {
         for (auto &e : printList->exprs) {
-            std::string var = generateTAC(e.get());
-            tac_list.push_back("print " + var);
+            TACArg var = generateTAC(e.get());
+            emitTAC(TAC_PRINT, TACArg(), var);
         }
-        return "";
+        return TACArg();
     } else if (auto program = dynamic_cast<Program*>(node)) {
         for (auto &stmt : program->stmts) generateTAC(stmt.get());
-        return "";
+        return TACArg();
     }
-    return "";
+    return TACArg();
+}
+
+void printTAC() {
+    std::cout << "\n=== Three-Address Code ===\n";
+    for (auto &t : tac_list) std::cout << tac_to_string(t) << "\n";
+    std::cout << "==========================\n";
 }
 
 void outputTAC(Program* root) {
     tac_list.clear();
     temp_counter = 0;
     generateTAC(root);
-    std::cout << "\n=== Three-Address Code ===\n";
-    for (auto &line : tac_list) std::cout << line << "\n";
-    std::cout << "==========================\n";
+    printTAC();
 }
 
 // -------------------- Main --------------------
+static void usage(const char *prog) {
+    std::cerr << "Usage: " << prog << " [options] source.fang|input.fir\n"
+              << "  --emit-ir FILE      write binary IR\n"
+              << "  -march=TARGET       sse2 (default) / avx2 / avx2-fma / native\n"
+              << "  --strict-fp         no FMA contraction, bit-exact with sse2\n"
+              << "  -j N                code generation threads (default: all cores)\n";
+}
+
 int main(int argc, char **argv) {
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " source.fang\n";
-        return 1;
+    std::string src, emit_ir;
+    AsmOptions asm_opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string a = argv[i];
+        if (a == "--emit-ir" && i + 1 < argc) emit_ir = argv[++i];
+        else if (a.rfind("--emit-ir=", 0) == 0) emit_ir = a.substr(10);
+        else if (a.rfind("-march=", 0) == 0) {
+            if (!parse_target_arch(a.substr(7), asm_opts.arch)) {
+                std::cerr << "Unknown target: " << a.substr(7) << "\n";
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (a == "--strict-fp") asm_opts.strict_fp = true;
+        else if (a == "-j" && i + 1 < argc) asm_opts.jobs = (unsigned)std::max(0, atoi(argv[++i]));
+        else if (a.rfind("-j", 0) == 0 && a.size() > 2) asm_opts.jobs = (unsigned)std::max(0, atoi(a.c_str() + 2));
+        else if (src.empty() && a[0] != '-') src = a;
+        else { usage(argv[0]); return 1; }
     }
+    if (src.empty()) { usage(argv[0]); return 1; }
+
+    int parse_result = 0;
+    double elapsed = 0;
+
+    if (ir_is_file(src)) {
+        // ------------------ 直接加载二进制 IR ------------------
+        IRFile ir;
+        std::string err;
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!ir.open(src, err)) { std::cerr << "❌ " << err << "\n"; return 1; }
+        g_program = ir_load_program(ir);
+        tac_list = ir_load_tac(ir);
+        auto end = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration<double>(end - start).count();
+
+        print_sym_table();
+        std::cout << "\nIR loaded: " << src << ". AST:\n";
+        g_program->dump_tree();
+        printTAC();
+    } else {
+        yyin = fopen(src.c_str(), "r");
+        if (!yyin) { perror("fopen"); return 1; }
+        yyrestart(yyin);
 
-    yyin = fopen(argv[1], "r");
-    if (!yyin) { perror("fopen"); return 1; }
-    yyrestart(yyin);
+        auto start = std::chrono::high_resolution_clock::now();
+        parse_result = yyparse();
+        auto end = std::chrono::high_resolution_clock::now();
+        elapsed = std::chrono::duration<double>(end - start).count();
 
-    auto start = std::chrono::high_resolution_clock::now();
-    int parse_result = yyparse();
-    auto end = std::chrono::high_resolution_clock::now();
-    double elapsed = std::chrono::duration<double>(end - start).count();
+        if (yyin) { fclose(yyin); yyin = nullptr; }
 
-    if (yyin) { fclose(yyin); yyin = nullptr; }
+        if (parse_result == 0) {
+            std::cout << "\nParse succeeded. AST:\n";
+            if (g_program) g_program->dump_tree();
 
-    if (parse_result == 0) {
-        std::cout << "\nParse succeeded. AST:\n";
-        if (g_program) g_program->dump_tree();
+            if (g_program) outputTAC(g_program);
+        }
+    }
 
-        if (g_program) outputTAC(g_program);
+    if (parse_result == 0) {
+        if (!emit_ir.empty()) {
+            if (g_program && ir_write(emit_ir, g_program, sym_table, tac_list))
+                std::cout << "\n✅ IR file generated: " << emit_ir << "\n";
+            else
+                std::cerr << "❌ Failed to write IR file " << emit_ir << "\n";
+        }
 
         // ------------------ 汇编生成 ------------------
         const std::string asm_out = "out.s";
-        if (g_program && generate_asm(g_program, asm_out)) {
-            std::cout << "\n✅ Assembly file generated: " << asm_out << "\n";
+        if (g_program && generate_asm(g_program, asm_out, asm_opts)) {
+            std::cout << "\n✅ Assembly file generated: " << asm_out
+                      << " (target " << target_arch_name(asm_opts.arch)
+                      << (asm_opts.strict_fp ? ", strict fp" : "") << ")\n";
 
             const std::string exe_out = "out";
             std::string cmd = "gcc -no-pie " + asm_out + " -o " + exe_out;
@@ -105,6 +174,10 @@ int main(int argc, char **argv) {
             if (rc == 0) {
                 std::cout << "✅ Executable generated: " << exe_out << "\n";
                 std::cout << "You can run it with: ./out\n";
+                if (!host_supports(asm_opts.arch))
+                    std::cout << "⚠ This CPU lacks " << target_arch_name(asm_opts.arch)
+                              << " support; ./out will not run here (host: "
+                              << target_arch_name(detect_host_arch()) << ")\n";
 
                 std::cout << "\n▶ Running program:\n";
                 std::cout << "(Please enter values when prompted)\n";
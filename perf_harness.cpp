@@ -0,0 +1,552 @@
+// =============================
+// perf_harness.cpp
+// 生成代码性能回归测试：编译语料库中的 Fang 程序，
+// 用脚本化 stdin 运行生成的可执行文件，采集硬件计数器
+// (instructions / cycles / branch-misses)、墙钟时间和输出校验和，
+// 并与已保存的基线按阈值比较。
+// 硬件计数器不可用时自动退化为仅计时模式。
+// =============================
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+using namespace std;
+
+// ===== 数据结构 =====
+struct BenchCase { string name; string source; string stdin_file; };
+
+struct Sample {
+    long long instructions = -1;   // -1 表示不可用
+    long long cycles = -1;
+    long long branch_misses = -1;
+    long long wall_ns = 0;
+    uint64_t checksum = 0;
+    bool ok = false;
+};
+
+struct Options {
+    string compiler = "./compiler";
+    string corpus = "bench/corpus.txt";
+    string baseline = "bench/baseline.txt";
+    string workdir = "bench_work";
+    int repeat = 15;
+    int kernel_size = 20000;
+    // 百分比，负数表示只报告不判定。instructions 几乎不受干扰，默认作为判定依据；
+    // Fang 没有循环，生成的直线代码以取指为瓶颈，cycles / branch-misses / 墙钟时间
+    // 随共享缓存的争用在不同时段之间成倍漂移，只在安静的机器上显式开启
+    double thr_instructions = 2.0;
+    double thr_cycles = -1.0;
+    double thr_branch_misses = -1.0;
+    double thr_wall = -1.0;
+    double thr_wall_time_only = 50.0;   // 没有硬件计数器时只能靠墙钟时间判定
+    bool update_baseline = false;
+    bool time_only = false;
+};
+
+static bool counters_available = true;
+
+// ===== 工具函数 =====
+static uint64_t fnv1a(const string &s) {
+    uint64_t h = 1469598103934665603ULL;
+    for (unsigned char c : s) { h ^= c; h *= 1099511628211ULL; }
+    return h;
+}
+
+static string abs_path(const string &p) {
+    char buf[PATH_MAX];
+    if (realpath(p.c_str(), buf)) return buf;
+    return p;
+}
+
+static long long median(vector<long long> v) {
+    if (v.empty()) return -1;
+    sort(v.begin(), v.end());
+    return v[v.size() / 2];
+}
+
+static long long minimum(const vector<long long> &v) {
+    if (v.empty()) return -1;
+    return *min_element(v.begin(), v.end());
+}
+
+// 中位数绝对偏差：样本离中位数的典型距离，不受个别离群值影响
+static long long mad(vector<long long> v) {
+    long long m = median(v);
+    if (m < 0) return -1;
+    for (long long &x : v) x = llabs(x - m);
+    return median(v);
+}
+
+// ===== 语料库 =====
+// 每行: 名称 源文件 stdin文件(可为 -)；# 开头为注释
+static vector<BenchCase> load_corpus(const string &path) {
+    vector<BenchCase> cases;
+    ifstream ifs(path);
+    if (!ifs) { cerr << "⚠ corpus not found: " << path << "\n"; return cases; }
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream iss(line);
+        BenchCase c;
+        if (!(iss >> c.name >> c.source)) continue;
+        if (!(iss >> c.stdin_file)) c.stdin_file = "-";
+        cases.push_back(c);
+    }
+    return cases;
+}
+
+// ===== 生成算术内核 =====
+// 只生成左结合的直线代码，保证后端对每条语句的求值路径一致
+static string gen_int_kernel(int n) {
+    ostringstream os;
+    os << "fang {\n    int a, b, c;\n    a = 7;\n    b = 3;\n    c = 1;\n";
+    for (int i = 0; i < n; ++i) {
+        switch (i % 4) {
+            case 0: os << "    a = a * 3 + " << (i % 97 + 1) << ";\n"; break;
+            case 1: os << "    b = b + a - c;\n"; break;
+            case 2: os << "    c = a / " << (i % 13 + 2) << " - b;\n"; break;
+            case 3: os << "    a = a - c * 2;\n"; break;
+        }
+    }
+    os << "    print(\"int\", a, b, c);\n}\n";
+    return os.str();
+}
+
+// x/y/z 的更新都是压缩映射，数值保持有界，但也会在几步之内忘掉之前的误差；
+// t 每轮按位置加权累加 x + y + z 且从不衰减，任何一条语句算错都会留在 t 里直到输出，
+// 权重随位置变化，不同位置的错误不会得到相同的 t。
+// q = x*z 是舍入后的乘积，x*z - q 在分步计算时恒为 0，合并为 FMA 时则是乘积的舍入误差；
+// s 累加这个误差并放大输出，使 FMA 与 --strict-fp 的差异反映到校验和上
+static string gen_real_kernel(int n) {
+    ostringstream os;
+    os << "fang {\n    real x, y, z, q, s, t;\n    x = 1.5;\n    y = 0.25;\n    z = 2.0;\n    s = 0.0;\n    t = 0.0;\n";
+    for (int i = 0; i < n; ++i) {
+        switch (i % 4) {
+            case 0: os << "    x = x * 0.999 + 0.5;\n"; break;
+            case 1: os << "    y = y * 0.5 + x * 0.001 - z * 0.001;\n"; break;
+            case 2: os << "    z = z * 0.25 + y * 0.5 + x / 3.0;\n    q = x * z;\n    s = x * z - q + s;\n"; break;
+            case 3: os << "    x = x * 0.5 - y * 0.125 + z * 0.0625;\n    t = t + x * " << (i % 7 + 1)
+                        << ".0 + y + z;\n"; break;
+        }
+    }
+    os << "    print(\"real\", x, y, z, s, t);\n";
+    os << "    print(\"scaled\", y * 1000000000000.0, s * 1000000000000000000.0);\n}\n";
+    return os.str();
+}
+
+static string gen_io_kernel(int n) {
+    ostringstream os;
+    os << "fang {\n    real s;\n    s = 0.0;\n";
+    for (int i = 0; i < n; ++i) {
+        os << "    v" << i << " = input(\"v: \");\n";
+        os << "    s = s + v" << i << ";\n";
+    }
+    os << "    print(\"sum\", s);\n}\n";
+    return os.str();
+}
+
+static bool write_file(const string &path, const string &text) {
+    ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << text;
+    return (bool)ofs;
+}
+
+// 空程序：只有动态链接器和 libc 的启动开销，作为扣除基准
+static BenchCase make_empty(const Options &opt) {
+    string path = opt.workdir + "/gen_empty.fang";
+    write_file(path, "fang {\n}\n");
+    return {"gen_empty", path, "-"};
+}
+
+static vector<BenchCase> make_kernels(const Options &opt) {
+    vector<BenchCase> cases;
+    int n = opt.kernel_size;
+    string dir = opt.workdir + "/";
+
+    write_file(dir + "gen_int.fang", gen_int_kernel(n));
+    cases.push_back({"gen_int_" + to_string(n), dir + "gen_int.fang", "-"});
+
+    write_file(dir + "gen_real.fang", gen_real_kernel(n));
+    cases.push_back({"gen_real_" + to_string(n), dir + "gen_real.fang", "-"});
+
+    int m = max(1, n / 20);
+    write_file(dir + "gen_io.fang", gen_io_kernel(m));
+    ostringstream in;
+    for (int i = 0; i < m; ++i) in << (i % 10) << "." << (i % 7) << "\n";
+    write_file(dir + "gen_io.in", in.str());
+    cases.push_back({"gen_io_" + to_string(m), dir + "gen_io.fang", dir + "gen_io.in"});
+    return cases;
+}
+
+// ===== 编译 =====
+// 编译器固定在当前目录输出 out.s / out，因此在工作目录中调用后改名
+static bool compile_case(const Options &opt, const BenchCase &c, const string &exe) {
+    string cmd = "cd '" + opt.workdir + "' && '" + abs_path(opt.compiler) + "' '" +
+                 abs_path(c.source) + "' > '" + c.name + ".log' 2>&1";
+    if (system(cmd.c_str()) != 0) return false;
+    string out = opt.workdir + "/out";
+    if (rename(out.c_str(), exe.c_str()) != 0) return false;
+    return true;
+}
+
+// ===== 硬件计数器 =====
+static int open_counter(pid_t pid, uint32_t type, uint64_t config) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.enable_on_exec = 1;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, pid, -1, -1, 0);
+}
+
+// 计数器被多路复用时按运行时间比例缩放
+static long long read_counter(int fd) {
+    if (fd < 0) return -1;
+    uint64_t buf[3] = {0, 0, 0};
+    if (read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) return -1;
+    if (buf[2] == 0) return -1;
+    if (buf[2] < buf[1]) return (long long)((double)buf[0] * buf[1] / buf[2]);
+    return (long long)buf[0];
+}
+
+// ===== 运行一次 =====
+static Sample run_once(const string &exe, const string &stdin_file, bool use_counters) {
+    Sample s;
+    int go[2], out[2], err[2];
+    if (pipe(go) != 0 || pipe(out) != 0 || pipe2(err, O_CLOEXEC) != 0) { perror("pipe"); return s; }
+
+    pid_t pid = fork();
+    if (pid < 0) { perror("fork"); return s; }
+    if (pid == 0) {
+        // 子进程：等待父进程挂好计数器后再 exec；
+        // 失败时把 errno 写进 err 管道，exec 成功则该管道随 CLOEXEC 关闭
+        close(go[1]); close(out[0]); close(err[0]);
+        auto fail = [&](int stage) {
+            int e[2] = { stage, errno };
+            if (write(err[1], e, sizeof(e)) < 0) {}
+            _exit(127);
+        };
+        char ch;
+        if (read(go[0], &ch, 1) != 1) fail(0);
+        close(go[0]);
+        int in = open(stdin_file == "-" ? "/dev/null" : stdin_file.c_str(), O_RDONLY);
+        if (in < 0) fail(1);
+        dup2(in, 0); close(in);
+        dup2(out[1], 1); close(out[1]);
+        execl(exe.c_str(), exe.c_str(), (char*)nullptr);
+        fail(2);
+    }
+
+    close(go[0]); close(out[1]); close(err[1]);
+    int fds[3] = {-1, -1, -1};
+    if (use_counters) {
+        fds[0] = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[1] = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[2] = open_counter(pid, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        if (fds[0] < 0 || fds[1] < 0 || fds[2] < 0) {
+            cerr << "⚠ perf_event_open failed (" << strerror(errno)
+                 << "), falling back to time-only mode\n";
+            counters_available = false;
+            for (int &fd : fds) if (fd >= 0) { close(fd); fd = -1; }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    if (write(go[1], "x", 1) != 1) perror("write");
+    close(go[1]);
+
+    int exec_err[2] = {0, 0};   // {阶段, errno}
+    bool exec_failed = read(err[0], exec_err, sizeof(exec_err)) == (ssize_t)sizeof(exec_err);
+    close(err[0]);
+
+    string output;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(out[0], buf, sizeof(buf))) > 0) output.append(buf, n);
+    close(out[0]);
+
+    int status = 0;
+    waitpid(pid, &status, 0);
+    auto end = chrono::steady_clock::now();
+
+    s.wall_ns = chrono::duration_cast<chrono::nanoseconds>(end - start).count();
+    s.instructions = read_counter(fds[0]);
+    s.cycles = read_counter(fds[1]);
+    s.branch_misses = read_counter(fds[2]);
+    for (int fd : fds) if (fd >= 0) close(fd);
+    s.checksum = fnv1a(output);
+    // 生成的程序以最后一次 printf 的返回值退出，退出码没有意义；只把 exec 失败和信号终止算作失败
+    if (exec_failed) {
+        static const char *stages[] = { "start ", "open stdin ", "exec " };
+        cerr << "⚠ cannot " << stages[exec_err[0]] << (exec_err[0] == 1 ? stdin_file : exe)
+             << ": " << strerror(exec_err[1]) << "\n";
+    }
+    else if (WIFSIGNALED(status)) cerr << "⚠ " << exe << " killed by signal " << WTERMSIG(status) << "\n";
+    s.ok = !exec_failed && !WIFSIGNALED(status);
+    return s;
+}
+
+// 汇总多次运行：instructions 几乎确定，取中位数；cycles / branch-misses / 墙钟时间
+// 受调度和缓存状态干扰只会偏大，取最小值。校验和必须每次一致。
+// noise 非空时同时给出各指标的中位数绝对偏差
+static Sample summarize(const vector<Sample> &runs, const string &exe, Sample *noise = nullptr) {
+    vector<long long> ins, cyc, bm, wall;
+    Sample result;
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const Sample &s = runs[i];
+        if (!s.ok) return s;
+        if (i == 0) result.checksum = s.checksum;
+        else if (s.checksum != result.checksum) {
+            cerr << "⚠ nondeterministic output from " << exe << "\n";
+            return Sample();
+        }
+        ins.push_back(s.instructions);
+        cyc.push_back(s.cycles);
+        bm.push_back(s.branch_misses);
+        wall.push_back(s.wall_ns);
+    }
+    auto has = [](const vector<long long> &v) {
+        return !v.empty() && all_of(v.begin(), v.end(), [](long long x) { return x >= 0; });
+    };
+    result.instructions = has(ins) ? median(ins) : -1;
+    result.cycles = has(cyc) ? minimum(cyc) : -1;
+    result.branch_misses = has(bm) ? minimum(bm) : -1;
+    result.wall_ns = minimum(wall);
+    result.ok = !runs.empty();
+    if (noise) {
+        noise->instructions = has(ins) ? mad(ins) : -1;
+        noise->cycles = has(cyc) ? mad(cyc) : -1;
+        noise->branch_misses = has(bm) ? mad(bm) : -1;
+        noise->wall_ns = mad(wall);
+        noise->ok = result.ok;
+    }
+    return result;
+}
+
+// 扣除空程序的启动开销，只留下生成代码本身的部分
+static long long net(long long v, long long startup) {
+    if (v < 0 || startup < 0) return v;
+    return max(0LL, v - startup);
+}
+
+static Sample subtract_startup(Sample s, const Sample &startup) {
+    s.instructions = net(s.instructions, startup.instructions);
+    s.cycles = net(s.cycles, startup.cycles);
+    s.branch_misses = net(s.branch_misses, startup.branch_misses);
+    s.wall_ns = net(s.wall_ns, startup.wall_ns);
+    return s;
+}
+
+// ===== 基线 =====
+// 每行: 名称 instructions cycles branch_misses wall_ns checksum(十六进制)
+static map<string, Sample> load_baseline(const string &path) {
+    map<string, Sample> base;
+    ifstream ifs(path);
+    string line;
+    while (getline(ifs, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        istringstream iss(line);
+        string name, sum;
+        Sample s;
+        if (!(iss >> name >> s.instructions >> s.cycles >> s.branch_misses >> s.wall_ns >> sum)) continue;
+        s.checksum = strtoull(sum.c_str(), nullptr, 16);
+        s.ok = true;
+        base[name] = s;
+    }
+    return base;
+}
+
+static bool save_baseline(const string &path, const vector<pair<string, Sample>> &rows) {
+    ofstream ofs(path);
+    if (!ofs) return false;
+    ofs << "# name instructions cycles branch_misses wall_ns checksum\n";
+    for (auto &r : rows) {
+        const Sample &s = r.second;
+        ofs << r.first << " " << s.instructions << " " << s.cycles << " " << s.branch_misses
+            << " " << s.wall_ns << " " << hex << s.checksum << dec << "\n";
+    }
+    return (bool)ofs;
+}
+
+// 返回 true 表示超出阈值；任意一方缺失该指标时跳过。
+// floor 为绝对噪声下限：增量不超过它时不算退化 (计时类指标取空程序各次运行的离散程度)
+static bool compare_metric(const char *name, long long base, long long cur, double thr, long long floor = 0) {
+    if (base < 0 || cur < 0) return false;
+    double delta = base == 0 ? 0.0 : 100.0 * (double)(cur - base) / (double)base;
+    if (thr < 0) {
+        printf("    %-14s %14lld -> %14lld  %+7.2f%%  (info)\n", name, base, cur, delta);
+        return false;
+    }
+    bool regress = (base == 0 ? cur > 0 : delta > thr) && cur - base > floor;
+    printf("    %-14s %14lld -> %14lld  %+7.2f%%  (limit %.1f%%)%s\n",
+           name, base, cur, delta, thr, regress ? "  ❌" : "");
+    return regress;
+}
+
+// ===== 命令行 =====
+static void usage(const char *prog) {
+    cerr << "Usage: " << prog << " [options]\n"
+         << "  --compiler PATH        compiler executable (default ./compiler)\n"
+         << "  --corpus FILE          corpus list (default bench/corpus.txt)\n"
+         << "  --baseline FILE        baseline file (default bench/baseline.txt)\n"
+         << "  --workdir DIR          scratch directory (default bench_work)\n"
+         << "  --repeat N             runs per program (default 15)\n"
+         << "  --kernel-size N        statements per generated kernel (default 20000)\n"
+         << "  --threshold-instructions PCT  (default 2)\n"
+         << "  --threshold-cycles PCT / --threshold-branch-misses PCT / --threshold-wall PCT\n"
+         << "                         off by default (reported only); increases within the\n"
+         << "                         run-to-run spread (MAD) of the empty program are ignored;\n"
+         << "                         in time-only mode wall time is checked at 50% by default\n"
+         << "  --update-baseline      write results as the new baseline\n"
+         << "  --time-only            skip hardware counters\n";
+}
+
+static bool parse_args(int argc, char **argv, Options &opt) {
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        auto next = [&](void) -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+        const char *v = nullptr;
+        if (a == "--update-baseline") opt.update_baseline = true;
+        else if (a == "--time-only") opt.time_only = true;
+        else if (a == "-h" || a == "--help") return false;
+        else if (!(v = next())) { cerr << "missing value for " << a << "\n"; return false; }
+        else if (a == "--compiler") opt.compiler = v;
+        else if (a == "--corpus") opt.corpus = v;
+        else if (a == "--baseline") opt.baseline = v;
+        else if (a == "--workdir") opt.workdir = v;
+        else if (a == "--repeat") opt.repeat = max(1, atoi(v));
+        else if (a == "--kernel-size") opt.kernel_size = max(1, atoi(v));
+        else if (a == "--threshold-instructions") opt.thr_instructions = atof(v);
+        else if (a == "--threshold-cycles") opt.thr_cycles = atof(v);
+        else if (a == "--threshold-branch-misses") opt.thr_branch_misses = atof(v);
+        else if (a == "--threshold-wall") opt.thr_wall = atof(v);
+        else { cerr << "unknown option " << a << "\n"; return false; }
+    }
+    return true;
+}
+
+// -------------------- Main --------------------
+int main(int argc, char **argv) {
+    Options opt;
+    if (!parse_args(argc, argv, opt)) { usage(argv[0]); return 2; }
+    if (opt.time_only) counters_available = false;
+
+    mkdir(opt.workdir.c_str(), 0755);
+    vector<BenchCase> cases = load_corpus(opt.corpus);
+    for (auto &k : make_kernels(opt)) cases.push_back(k);
+
+    map<string, Sample> base = load_baseline(opt.baseline);
+    vector<pair<string, Sample>> results;
+    int failures = 0;
+
+    // 空程序排在第一个，其结果从其他结果中扣除 (基线中保存的也是扣除后的值)
+    cases.insert(cases.begin(), make_empty(opt));
+    vector<string> exes(cases.size());
+    vector<bool> compiled(cases.size(), false);
+    for (size_t i = 0; i < cases.size(); ++i) {
+        exes[i] = opt.workdir + "/" + cases[i].name + ".bin";
+        compiled[i] = compile_case(opt, cases[i], exes[i]);
+        if (!compiled[i] && i > 0) {
+            cerr << "❌ compile failed: " << cases[i].source << " (see " << opt.workdir << "/"
+                 << cases[i].name << ".log)\n";
+            ++failures;
+        }
+    }
+
+    // 按轮交错运行：每轮把所有程序各跑一次，持续一段时间的系统干扰会分摊到各个程序，
+    // 不会让某个程序的全部样本都落在同一段干扰里
+    vector<vector<Sample>> runs(cases.size());
+    for (int r = 0; r < opt.repeat; ++r)
+        for (size_t i = 0; i < cases.size(); ++i)
+            if (compiled[i] && (runs[i].empty() || runs[i].back().ok))
+                runs[i].push_back(run_once(exes[i], cases[i].stdin_file, counters_available && !opt.time_only));
+
+    // 空程序各次运行之间的离散程度作为计时类指标的噪声下限：它反映的是运行间的抖动，
+    // 与程序本身的耗时大小无关。1.4826 × MAD 是正态分布下标准差的稳健估计，取 3 倍
+    Sample noise;
+    Sample startup = compiled[0] ? summarize(runs[0], exes[0], &noise) : Sample();
+    auto floor_of = [](long long m) { return m < 0 ? 0LL : (long long)(3 * 1.4826 * (double)m); };
+    noise.cycles = floor_of(noise.cycles);
+    noise.branch_misses = floor_of(noise.branch_misses);
+    noise.wall_ns = floor_of(noise.wall_ns);
+    if (startup.ok)
+        printf("▶ startup (empty program, subtracted below)\n"
+               "    instructions=%lld cycles=%lld branch-misses=%lld wall=%lldns\n"
+               "    noise floor (3 sigma): cycles=%lld branch-misses=%lld wall=%lldns\n",
+               startup.instructions, startup.cycles, startup.branch_misses, startup.wall_ns,
+               noise.cycles, noise.branch_misses, noise.wall_ns);
+    else
+        cerr << "⚠ cannot measure empty program; startup cost is not subtracted\n";
+
+    for (size_t i = 1; i < cases.size(); ++i) {
+        const BenchCase &c = cases[i];
+        if (!compiled[i]) continue;
+        cout << "▶ " << c.name << "\n";
+        Sample s = summarize(runs[i], exes[i]);
+        if (!s.ok) { cerr << "❌ run failed: " << exes[i] << "\n"; ++failures; continue; }
+        if (startup.ok) s = subtract_startup(s, startup);
+        results.push_back({c.name, s});
+
+        auto it = base.find(c.name);
+        if (opt.update_baseline || it == base.end()) {
+            printf("    instructions=%lld cycles=%lld branch-misses=%lld wall=%lldns checksum=%016llx\n",
+                   s.instructions, s.cycles, s.branch_misses, s.wall_ns,
+                   (unsigned long long)s.checksum);
+            if (it == base.end() && !opt.update_baseline) cout << "    (no baseline)\n";
+            continue;
+        }
+
+        const Sample &b = it->second;
+        bool bad = false;
+        if (b.checksum != s.checksum) {
+            printf("    ❌ output checksum changed: %016llx -> %016llx\n",
+                   (unsigned long long)b.checksum, (unsigned long long)s.checksum);
+            bad = true;
+        }
+        bad |= compare_metric("instructions", b.instructions, s.instructions, opt.thr_instructions);
+        bad |= compare_metric("cycles", b.cycles, s.cycles, opt.thr_cycles, noise.cycles);
+        bad |= compare_metric("branch-misses", b.branch_misses, s.branch_misses, opt.thr_branch_misses,
+                              noise.branch_misses);
+        double thr_wall = (opt.thr_wall < 0 && !counters_available) ? opt.thr_wall_time_only : opt.thr_wall;
+        bad |= compare_metric("wall-ns", b.wall_ns, s.wall_ns, thr_wall, noise.wall_ns);
+        if (bad) ++failures;
+    }
+
+    if (!counters_available) cout << "\nℹ hardware counters unavailable: time-only mode\n";
+
+    if (opt.update_baseline) {
+        if (!save_baseline(opt.baseline, results)) {
+            cerr << "❌ failed to write baseline " << opt.baseline << "\n";
+            return 1;
+        }
+        cout << "\n✅ Baseline written: " << opt.baseline << "\n";
+        return failures ? 1 : 0;
+    }
+
+    if (failures) { cout << "\n❌ " << failures << " regression(s)\n"; return 1; }
+    cout << "\n✅ No regressions\n";
+    return 0;
+}
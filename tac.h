@@ -0,0 +1,61 @@
+#ifndef TAC_H
+#define TAC_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ======= 三地址码 =======
+// 每条指令为 {op, dst, arg1, arg2}，操作数带种类，使用者无需再解析文本
+enum TACOp : uint8_t {
+    TAC_COPY = 0,   // dst = arg1
+    TAC_BINARY,     // dst = arg1 oper arg2
+    TAC_STRING,     // dst = "arg1"
+    TAC_INPUT,      // dst = input(arg1)
+    TAC_PRINT,      // print arg1
+    TAC_OP_COUNT
+};
+
+enum TACArgKind : uint8_t {
+    TAC_NONE = 0,
+    TAC_TEMP,       // 临时变量 t<temp>
+    TAC_VAR,        // 变量名
+    TAC_INT,        // 整数常量 (十进制文本)
+    TAC_REAL,       // 实数常量 (十进制文本)
+    TAC_STR,        // 字符串字面量 / 输入提示
+    TAC_ARG_KIND_COUNT
+};
+
+struct TACArg {
+    TACArgKind kind = TAC_NONE;
+    uint32_t temp = 0;
+    std::string text;   // 除 TAC_TEMP 外的操作数内容
+};
+
+struct TACInstr {
+    TACOp op = TAC_COPY;
+    std::string oper;   // TAC_BINARY 的运算符
+    TACArg dst, arg1, arg2;
+};
+
+inline TACArg tac_temp(uint32_t n) { TACArg a; a.kind = TAC_TEMP; a.temp = n; return a; }
+inline TACArg tac_arg(TACArgKind kind, const std::string &text) { TACArg a; a.kind = kind; a.text = text; return a; }
+
+inline std::string tac_arg_str(const TACArg &a) {
+    return a.kind == TAC_TEMP ? "t" + std::to_string(a.temp) : a.text;
+}
+
+// 输出为可读文本，仅用于显示
+inline std::string tac_to_string(const TACInstr &t) {
+    std::string dst = tac_arg_str(t.dst), a1 = tac_arg_str(t.arg1);
+    switch (t.op) {
+        case TAC_COPY:   return dst + " = " + a1;
+        case TAC_BINARY: return dst + " = " + a1 + " " + t.oper + " " + tac_arg_str(t.arg2);
+        case TAC_STRING: return dst + " = \"" + a1 + "\"";
+        case TAC_INPUT:  return dst + " = input(" + a1 + ")";
+        case TAC_PRINT:  return "print " + a1;
+        default:         return "";
+    }
+}
+
+#endif // TAC_H